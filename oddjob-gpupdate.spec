@@ -35,7 +35,8 @@ pam_oddjob_gpupdate module to applies group policy objects at login-time.
     --enable-pie \
     --enable-now \
     --with-selinux-acls \
-    --with-selinux-labels
+    --with-selinux-labels \
+    --with-state-dir=%_localstatedir/oddjob-gpupdate
 %make_build
 
 %install
@@ -55,6 +56,7 @@ rm %buildroot%_libdir/security/pam_oddjob_gpupdate.la
 %files
 %doc COPYING src/gpupdatefor src/gpupdateforme
 %_libexecdir/oddjob/gpupdate
+%dir %attr(0700,root,root) %_localstatedir/oddjob-gpupdate
 /%_lib/security/pam_oddjob_gpupdate.so
 %_mandir/*/pam_oddjob_gpupdate.*
 %_mandir/*/oddjob-gpupdate.*
@@ -45,6 +45,10 @@
 #define ODDJOB_INTERFACE_ENV_VAR	PACKAGE_NAME_CAPS "_INTERFACE_NAME"
 #define ODDJOB_METHOD_ENV_VAR		PACKAGE_NAME_CAPS "_METHOD_NAME"
 #define ODDJOB_CALLING_USER_VAR		PACKAGE_NAME_CAPS "_CALLING_USER"
+#define ODDJOB_IN_FLIGHT_FILE		ODDJOB_GPUPDATE_STATE_DIR "/in-flight"
+#define ODDJOB_FORCE_BUDGET_FILE	ODDJOB_GPUPDATE_STATE_DIR "/force-budget"
+/* What oddjobd tells its helpers the caller's name is in. */
+#define ODDJOBD_CALLING_USER_VAR	"ODDJOB_CALLING_USER"
 #define ODDJOB_USER_FNMATCH_FLAGS	(FNM_NOESCAPE)
 #define ODDJOB_OBJECT_FNMATCH_FLAGS	(FNM_PATHNAME | FNM_NOESCAPE)
 #define ODDJOB_SECONTEXT_FNMATCH_FLAGS	(FNM_NOESCAPE)
@@ -30,20 +30,27 @@
 
 #include "../config.h"
 #include <sys/types.h>
+#include <sys/file.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <pwd.h>
+#include <signal.h>
 #include <syslog.h>
 #include <dbus/dbus.h>
+#include "common.h"
 #include "handlers.h"
 #include "selinux.h"
 #include "util.h"
@@ -55,6 +62,37 @@ static struct passwd *pwd;
 
 #define FLAG_QUIET	(1 << 1)
 #define FLAG_FORCE	(1 << 2)
+#define FLAG_DEFER	(1 << 3)
+
+/* How many requests each calling user, and everyone together, can have in
+ * progress at once, with 0 meaning no limit.  Root isn't held to the limit
+ * for a single user, because that's who the PAM module calls as. */
+static int max_per_caller = 4;
+static int max_in_flight = 0;
+
+/* Who's calling us: 'u' and a UID for callers with an account, 'n' and the
+ * name oddjobd gave us for anyone else, so that a name can't pass for a
+ * UID, or 0 if we can't tell. */
+static char caller_kind;
+static char caller_id[LINE_MAX];
+static int caller_is_root;
+
+/* Forced refreshes re-download everything, so each calling user and each
+ * target gets a budget of applier CPU time for them, which refills at a
+ * steady rate.  A forced refresh is allowed while both budgets have any time
+ * left.  Whatever is left is set aside for it while it runs, and what it
+ * actually used is taken from both afterwards. */
+static double force_budget = 120.0;
+static double force_refill = 3600.0;
+
+struct force_bucket {
+	char kind;		/* 'u' for a calling user's UID, 'n' for a caller
+				   with no UID, 't' for a target user, 'c' for
+				   the computer */
+	char key[LINE_MAX];
+	double left;
+	time_t stamp;
+};
 
 /*
  * get_gpo_dir
@@ -69,9 +107,10 @@ get_gpo_exe(void)
 	return gpo_exe ? gpo_exe : "/usr/sbin/gpoa";
 }
 
-static int apply_gpo(const char *user, int flags)
+static int apply_gpo(const char *user, int flags, double *cpu)
 {
 	int status;
+	struct rusage ru;
 	pid_t pid = fork();
 
 	switch (pid) {
@@ -83,14 +122,502 @@ static int apply_gpo(const char *user, int flags)
 	} else {
 		execl(exe, exe, user, NULL);
 	}
-		return 3;
+		_exit(3);
 	default:
-		if (waitpid(pid, &status, 0) < 0)
+		if (wait4(pid, &status, 0, &ru) < 0)
 			return 2;
+		*cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
 	}
 	return 0;
 }
 
+/* Look up the caller oddjobd is running us for.  Names which wouldn't fit in
+ * our state files aren't tracked. */
+static void
+get_caller(void)
+{
+	const char *caller;
+	struct passwd *cpwd;
+
+	caller_kind = 0;
+	caller_is_root = 0;
+	caller = getenv(ODDJOBD_CALLING_USER_VAR);
+	if (caller == NULL) {
+		return;
+	}
+	cpwd = getpwnam(caller);
+	if (cpwd != NULL) {
+		caller_kind = 'u';
+		snprintf(caller_id, sizeof(caller_id), "%lu",
+			 (unsigned long) cpwd->pw_uid);
+		caller_is_root = (cpwd->pw_uid == 0);
+	} else if ((strlen(caller) > 0) &&
+		   (strlen(caller) < sizeof(caller_id)) &&
+		   (strpbrk(caller, " \t\r\n") == NULL)) {
+		caller_kind = 'n';
+		snprintf(caller_id, sizeof(caller_id), "%s", caller);
+	}
+}
+
+/* Open and lock one of the files in which we keep state. */
+static FILE *
+state_open(const char *path)
+{
+	FILE *fp;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (fd == -1) {
+		syslog(LOG_ERR, "error opening %s: %s", path, strerror(errno));
+		return NULL;
+	}
+	if ((flock(fd, LOCK_EX) != 0) || ((fp = fdopen(fd, "r+")) == NULL)) {
+		syslog(LOG_ERR, "error locking %s: %s", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	return fp;
+}
+
+/* Replace what's in a state file with the given lines, and free them. */
+static void
+state_write(FILE *fp, const char *path, char **lines, int n_lines)
+{
+	int i;
+
+	rewind(fp);
+	if (ftruncate(fileno(fp), 0) != 0) {
+		syslog(LOG_ERR, "error truncating %s: %s", path,
+		       strerror(errno));
+	}
+	for (i = 0; i < n_lines; i++) {
+		fputs(lines[i], fp);
+		oddjob_free(lines[i]);
+	}
+	oddjob_free(lines);
+	fflush(fp);
+}
+
+/* Read the list of requests in progress, leaving out the ones whose helpers
+ * are gone, and count the ones which are ours and everyone's.  The list is
+ * left for state_write(). */
+static char **
+in_flight_load(FILE *fp, int *n_lines, int *mine, int *all)
+{
+	char line[LINE_MAX + 64], key[LINE_MAX + 64], kind, **lines;
+	long pid;
+
+	lines = NULL;
+	*n_lines = *mine = *all = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%ld %c %s", &pid, &kind, key) != 3) {
+			continue;
+		}
+		if ((pid == getpid()) ||
+		    ((kill((pid_t) pid, 0) != 0) && (errno == ESRCH))) {
+			continue;
+		}
+		(*all)++;
+		if ((caller_kind != 0) && (kind == caller_kind) &&
+		    (strcmp(key, caller_id) == 0)) {
+			(*mine)++;
+		}
+		oddjob_resize_array((void **) &lines, sizeof(lines[0]),
+				    *n_lines, *n_lines + 1);
+		lines[(*n_lines)++] = oddjob_strdup(line);
+	}
+	return lines;
+}
+
+/* Add this request to the list of those in progress, unless that would put
+ * its caller, or everyone together, over the limit.  Returns 1 if it can go
+ * ahead, 0 if it can't, with the number of requests which are in its way in
+ * *busy, and -1 if the list can't be read. */
+static int
+in_flight_enter(int *busy)
+{
+	char line[LINE_MAX + 64], **lines;
+	FILE *fp;
+	int n_lines, mine, all, ret;
+
+	*busy = 0;
+	if ((max_in_flight <= 0) && (max_per_caller <= 0)) {
+		return 1;
+	}
+	if ((fp = state_open(ODDJOB_IN_FLIGHT_FILE)) == NULL) {
+		syslog(LOG_ERR, "can't keep track of requests in progress, "
+		       "not limiting them");
+		return -1;
+	}
+	lines = in_flight_load(fp, &n_lines, &mine, &all);
+	ret = 1;
+	if ((max_in_flight > 0) && (all >= max_in_flight)) {
+		*busy = all;
+		ret = 0;
+	} else if ((max_per_caller > 0) && (caller_kind != 0) &&
+		   !caller_is_root && (mine >= max_per_caller)) {
+		*busy = mine;
+		ret = 0;
+	}
+	if (ret == 1) {
+		snprintf(line, sizeof(line), "%ld %c %s\n", (long) getpid(),
+			 caller_kind ? caller_kind : '-',
+			 caller_kind ? caller_id : "-");
+		oddjob_resize_array((void **) &lines, sizeof(lines[0]),
+				    n_lines, n_lines + 1);
+		lines[n_lines++] = oddjob_strdup(line);
+	}
+	state_write(fp, ODDJOB_IN_FLIGHT_FILE, lines, n_lines);
+	fclose(fp);
+	return ret;
+}
+
+/* Take this request off the list of those in progress. */
+static void
+in_flight_leave(void)
+{
+	char **lines;
+	FILE *fp;
+	int n_lines, mine, all;
+
+	if ((fp = state_open(ODDJOB_IN_FLIGHT_FILE)) == NULL) {
+		return;
+	}
+	lines = in_flight_load(fp, &n_lines, &mine, &all);
+	state_write(fp, ODDJOB_IN_FLIGHT_FILE, lines, n_lines);
+	fclose(fp);
+}
+
+/* Read the budgets, or at least the ones we care about, and top them up for
+ * the time which has passed since they were last used. */
+static void
+force_load(FILE *fp, struct force_bucket *buckets, int n_buckets,
+	   time_t now)
+{
+	char line[LINE_MAX + 64], key[LINE_MAX + 64], kind;
+	double left;
+	long stamp;
+	int i;
+
+	for (i = 0; i < n_buckets; i++) {
+		buckets[i].left = force_budget;
+		buckets[i].stamp = now;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%c %s %lf %ld", &kind, key, &left,
+			   &stamp) != 4) {
+			continue;
+		}
+		for (i = 0; i < n_buckets; i++) {
+			if ((buckets[i].kind == kind) &&
+			    (strcmp(buckets[i].key, key) == 0)) {
+				buckets[i].left = left;
+				buckets[i].stamp = stamp;
+			}
+		}
+	}
+	for (i = 0; i < n_buckets; i++) {
+		if (now > buckets[i].stamp) {
+			buckets[i].left += (now - buckets[i].stamp) *
+					   force_budget / force_refill;
+		}
+		if (buckets[i].left > force_budget) {
+			buckets[i].left = force_budget;
+		}
+		buckets[i].stamp = now;
+	}
+}
+
+/* Write the budgets back, leaving out the ones which are full anyway, so that
+ * the file only lists callers and targets which have been busy lately. */
+static void
+force_save(FILE *fp, struct force_bucket *buckets, int n_buckets,
+	   time_t now)
+{
+	char line[LINE_MAX + 64], key[LINE_MAX + 64], kind, **keep;
+	double left;
+	long stamp;
+	int i, n_keep;
+
+	rewind(fp);
+	keep = NULL;
+	n_keep = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%c %s %lf %ld", &kind, key, &left,
+			   &stamp) != 4) {
+			continue;
+		}
+		for (i = 0; i < n_buckets; i++) {
+			if ((buckets[i].kind == kind) &&
+			    (strcmp(buckets[i].key, key) == 0)) {
+				break;
+			}
+		}
+		if ((i < n_buckets) ||
+		    (left + (now - stamp) * force_budget / force_refill >=
+		     force_budget)) {
+			continue;
+		}
+		oddjob_resize_array((void **) &keep, sizeof(keep[0]),
+				    n_keep, n_keep + 1);
+		keep[n_keep++] = oddjob_strdup(line);
+	}
+	for (i = 0; i < n_buckets; i++) {
+		if (buckets[i].left < force_budget) {
+			snprintf(line, sizeof(line), "%c %s %.3f %ld\n",
+				 buckets[i].kind, buckets[i].key,
+				 buckets[i].left, (long) buckets[i].stamp);
+			oddjob_resize_array((void **) &keep, sizeof(keep[0]),
+					    n_keep, n_keep + 1);
+			keep[n_keep++] = oddjob_strdup(line);
+		}
+	}
+	state_write(fp, ODDJOB_FORCE_BUDGET_FILE, keep, n_keep);
+}
+
+/* Figure out whose budgets a forced refresh comes out of: the caller's and
+ * the user's or the computer's being updated.  Each kind of key gets its own
+ * tag, so that a user can't pass for the computer.  Root's requests are
+ * always honored, and neither are names which wouldn't fit in the file. */
+static int
+force_buckets(const char *user, struct force_bucket *buckets)
+{
+	int n;
+
+	n = 0;
+	if (caller_is_root) {
+		return 0;
+	}
+	if (caller_kind != 0) {
+		buckets[n].kind = caller_kind;
+		snprintf(buckets[n].key, sizeof(buckets[n].key), "%s",
+			 caller_id);
+		n++;
+	}
+	if (user == NULL) {
+		buckets[n].kind = 'c';
+		snprintf(buckets[n].key, sizeof(buckets[n].key), "-");
+		n++;
+	} else if (strpbrk(user, " \t\r\n") == NULL) {
+		buckets[n].kind = 't';
+		snprintf(buckets[n].key, sizeof(buckets[n].key), "%s", user);
+		n++;
+	}
+	return n;
+}
+
+/* Check if there's budget left for a forced refresh and, without letting go
+ * of the lock, set aside everything that's left for it, so that refreshes
+ * which start while it runs can't spend the same time.  Returns 1 if it can
+ * go ahead, 0 if it's over budget, in which case *wait says how many seconds
+ * it'll be until it isn't, and -1 if the budgets can't be read. */
+static int
+force_reserve(const char *user, struct force_bucket *buckets, int *n_buckets,
+	      double *reserved, long *wait)
+{
+	FILE *fp;
+	time_t now;
+	double need;
+	int i, n;
+
+	*wait = 0;
+	n = *n_buckets = force_buckets(user, buckets);
+	if (n == 0) {
+		return 1;
+	}
+	if ((fp = state_open(ODDJOB_FORCE_BUDGET_FILE)) == NULL) {
+		syslog(LOG_ERR, "forced refresh budgets are unavailable, "
+		       "not allowing forced refreshes");
+		return -1;
+	}
+	now = time(NULL);
+	force_load(fp, buckets, n, now);
+	need = 0;
+	for (i = 0; i < n; i++) {
+		if (-buckets[i].left > need) {
+			need = -buckets[i].left;
+		}
+		if (buckets[i].left <= 0) {
+			*wait = 1;
+		}
+	}
+	if (*wait != 0) {
+		fclose(fp);
+		*wait = need * force_refill / force_budget + 1;
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		reserved[i] = buckets[i].left;
+		buckets[i].left = 0;
+	}
+	force_save(fp, buckets, n, now);
+	fclose(fp);
+	return 1;
+}
+
+/* Give back what force_reserve() set aside for a forced refresh, and take the
+ * CPU time it actually used. */
+static void
+force_settle(struct force_bucket *buckets, int n_buckets,
+	     const double *reserved, double cpu)
+{
+	FILE *fp;
+	time_t now;
+	int i;
+
+	if ((n_buckets == 0) || ((fp = state_open(ODDJOB_FORCE_BUDGET_FILE)) == NULL)) {
+		return;
+	}
+	now = time(NULL);
+	force_load(fp, buckets, n_buckets, now);
+	for (i = 0; i < n_buckets; i++) {
+		buckets[i].left += reserved[i] - cpu;
+	}
+	force_save(fp, buckets, n_buckets, now);
+	fclose(fp);
+}
+
+/* Read the generation, state ('r' while running, 'd' when done) and result
+ * of the last update recorded in a target's run file. */
+static long long
+coalesce_read(int fd, char *state, int *result)
+{
+	char buf[64];
+	long long generation;
+	ssize_t n;
+
+	*state = 0;
+	*result = 0;
+	n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0) {
+		return 0;
+	}
+	buf[n] = '\0';
+	if (sscanf(buf, "%lld %c %d", &generation, state, result) != 3) {
+		*state = 0;
+		return 0;
+	}
+	return generation;
+}
+
+static void
+coalesce_write(int fd, long long generation, char state, int result)
+{
+	char buf[64];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%lld %c %d\n", generation, state,
+		       result);
+	if ((pwrite(fd, buf, len, 0) != len) || (ftruncate(fd, len) != 0)) {
+		syslog(LOG_ERR, "error recording update state: %s",
+		       strerror(errno));
+	}
+}
+
+/* Find out if the same update of the same target is already running.  If it
+ * is, wait for it to finish, put its result in *result, and return 1.
+ * Otherwise, return 0, with the target's run file locked in *fd while we do
+ * the update ourselves, or -1 in *fd if it can't be used. */
+static int
+coalesce_begin(const char *user, int flags, int *fd, long long *generation,
+	       int *result)
+{
+	char path[PATH_MAX], state;
+	long long running;
+
+	*fd = -1;
+	if ((user != NULL) &&
+	    ((strchr(user, '/') != NULL) || (strpbrk(user, " \t\r\n") != NULL))) {
+		return 0;
+	}
+	if (snprintf(path, sizeof(path), "%s/%s-%s%s",
+		     ODDJOB_GPUPDATE_STATE_DIR,
+		     (flags & FLAG_FORCE) ? "forced" : "normal",
+		     user ? "user-" : "computer", user ? user : "") >=
+	    (int) sizeof(path)) {
+		return 0;
+	}
+	*fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (*fd == -1) {
+		syslog(LOG_ERR, "error opening %s: %s", path, strerror(errno));
+		return 0;
+	}
+	if (flock(*fd, LOCK_EX | LOCK_NB) == 0) {
+		*generation = coalesce_read(*fd, &state, result) + 1;
+		coalesce_write(*fd, *generation, 'r', 0);
+		return 0;
+	}
+	/* Someone else is running it.  If they haven't said so yet, the
+	 * run we're waiting for is the one after the last one recorded. */
+	running = coalesce_read(*fd, &state, result);
+	if (state != 'r') {
+		running++;
+	}
+	if (flock(*fd, LOCK_SH) == 0) {
+		if ((coalesce_read(*fd, &state, result) >= running) &&
+		    (state == 'd')) {
+			close(*fd);
+			*fd = -1;
+			return 1;
+		}
+	}
+	/* It didn't get as far as recording a result, so do it ourselves. */
+	close(*fd);
+	*fd = -1;
+	return 0;
+}
+
+/* Record the result of an update we ran, for anyone who was waiting on it. */
+static void
+coalesce_end(int fd, long long generation, int result)
+{
+	if (fd == -1) {
+		return;
+	}
+	coalesce_write(fd, generation, 'd', result);
+	close(fd);
+}
+
+/* Parse a count given on the command line.  Anything which isn't one is
+ * logged and leaves the default alone. */
+static void
+parse_count(int option, const char *arg, int *count)
+{
+	char *end;
+	long value;
+
+	errno = 0;
+	value = strtol(arg, &end, 10);
+	if ((end == arg) || (*end != '\0') || (errno != 0) ||
+	    (value < 0) || (value > INT_MAX)) {
+		syslog(LOG_ERR, "ignoring invalid value \"%s\" for -%c, "
+		       "using %d", arg, option, *count);
+		return;
+	}
+	*count = value;
+}
+
+/* Parse a number of seconds given on the command line.  Anything which isn't
+ * one is logged and leaves the default alone, so that a typo can't turn a
+ * limit off. */
+static void
+parse_seconds(int option, const char *arg, double *seconds, int zero_ok)
+{
+	char *end;
+	double value;
+
+	errno = 0;
+	value = strtod(arg, &end);
+	if ((end == arg) || (*end != '\0') || (errno != 0) ||
+	    !isfinite(value) || (value < 0) || ((value == 0) && !zero_ok)) {
+		syslog(LOG_ERR, "ignoring invalid value \"%s\" for -%c, "
+		       "using %g", arg, option, *seconds);
+		return;
+	}
+	*seconds = value;
+}
+
 /* Apply group policies via GPO applier. */
 static int
 gpupdate(const char *user, int flags)
@@ -98,6 +625,11 @@ gpupdate(const char *user, int flags)
 	int ret;
 	struct stat st;
 	const char *log_user = user;
+	struct force_bucket buckets[2];
+	double cpu = 0, reserved[2];
+	long wait;
+	long long generation = 0;
+	int entered, busy, n_buckets = 0, allowed = 1, run_fd;
 
 	/* Now make sure that the user or computer
 	   a) no user (computer)
@@ -141,12 +673,92 @@ gpupdate(const char *user, int flags)
 				return HANDLER_INVALID_INVOCATION;
 			}
 		}
-		ret = apply_gpo(user, flags);
-		if (ret != 0) {
-			syslog(LOG_ERR,
-			       "error applying GPO for %s (error code %d)", log_user, ret);
+		/* Turn the request away right now if too many are already
+		 * in progress, rather than have it wait behind them. */
+		get_caller();
+		entered = in_flight_enter(&busy);
+		if (entered == 0) {
+			printf(_("%sToo many group policy updates are in "
+				 "progress (%d), try again once some of them "
+				 "are done."),
+			       (flags & FLAG_QUIET) ? "" : " ", busy);
+			syslog(LOG_NOTICE, "Turned away update for %s, with "
+			       "%d requests in progress.", log_user, busy);
 			return HANDLER_FAILURE;
 		}
+		/* Forced refreshes which are over budget, or whose budget
+		 * can't be checked, are turned into normal ones, or put off if
+		 * we were asked to. */
+		if ((flags & FLAG_FORCE) && (force_budget > 0)) {
+			allowed = force_reserve(user, buckets, &n_buckets,
+						reserved, &wait);
+		}
+		if (allowed < 0) {
+			if (flags & FLAG_DEFER) {
+				printf(_("%sForced refresh postponed: the "
+					 "budget for forced refreshes can't "
+					 "be checked."),
+				       (flags & FLAG_QUIET) ? "" : " ");
+			} else {
+				printf(_("%sThe budget for forced refreshes "
+					 "can't be checked, so this is a "
+					 "normal refresh."),
+				       (flags & FLAG_QUIET) ? "" : " ");
+			}
+		} else if (allowed == 0) {
+			if (flags & FLAG_DEFER) {
+				printf(_("%sForced refresh postponed: the "
+					 "budget for forced refreshes is used "
+					 "up, try again in %ld seconds."),
+				       (flags & FLAG_QUIET) ? "" : " ", wait);
+				syslog(LOG_NOTICE, "Postponed forced refresh "
+				       "for %s for %ld seconds.", log_user,
+				       wait);
+			} else {
+				printf(_("%sThe budget for forced refreshes "
+					 "is used up, so this is a normal "
+					 "refresh; a forced one will be "
+					 "possible in %ld seconds."),
+				       (flags & FLAG_QUIET) ? "" : " ", wait);
+				syslog(LOG_NOTICE, "Downgraded forced refresh "
+				       "for %s to a normal one for %ld "
+				       "seconds.", log_user, wait);
+			}
+		}
+		if (allowed <= 0) {
+			if (flags & FLAG_DEFER) {
+				if (entered > 0) {
+					in_flight_leave();
+				}
+				return HANDLER_FAILURE;
+			}
+			flags &= ~FLAG_FORCE;
+		}
+		/* If the same update of the same target is already running,
+		 * pass its result on instead of running the applier again. */
+		if (coalesce_begin(user, flags, &run_fd, &generation, &ret)) {
+			printf(_("%sThe same update was already in progress, "
+				 "so this is its result."),
+			       (flags & FLAG_QUIET) ? "" : " ");
+			syslog(LOG_INFO, "Joined the update for %s which was "
+			       "already in progress.", log_user);
+			cpu = 0;
+		} else {
+			ret = apply_gpo(user, flags, &cpu);
+			if (ret != 0) {
+				syslog(LOG_ERR,
+				       "error applying GPO for %s (error code %d)", log_user, ret);
+				ret = HANDLER_FAILURE;
+			}
+			coalesce_end(run_fd, generation, ret);
+		}
+		if ((flags & FLAG_FORCE) && (force_budget > 0)) {
+			force_settle(buckets, n_buckets, reserved, cpu);
+		}
+		if (entered > 0) {
+			in_flight_leave();
+		}
+		return ret;
 	}
 	return 0;
 }
@@ -160,7 +772,7 @@ main(int argc, char **argv)
 	openlog(PACKAGE "-gpupdate", LOG_PID, LOG_DAEMON);
 	gpo_exe = "/usr/sbin/gpoa";
 
-	while ((ret = getopt(argc, argv, "qfp:")) != -1) {
+	while ((ret = getopt(argc, argv, "qfdb:r:u:a:p:")) != -1) {
 		switch (ret) {
 		case 'q':
 			flags |= FLAG_QUIET;
@@ -168,6 +780,21 @@ main(int argc, char **argv)
 		case 'f':
 			flags |= FLAG_FORCE;
 			break;
+		case 'd':
+			flags |= FLAG_DEFER;
+			break;
+		case 'b':
+			parse_seconds(ret, optarg, &force_budget, 1);
+			break;
+		case 'r':
+			parse_seconds(ret, optarg, &force_refill, 0);
+			break;
+		case 'u':
+			parse_count(ret, optarg, &max_per_caller);
+			break;
+		case 'a':
+			parse_count(ret, optarg, &max_in_flight);
+			break;
 		case 'p':
 			gpo_exe = optarg;
 			break;
@@ -176,8 +803,21 @@ main(int argc, char **argv)
 				"-q\tDo not print messages when applying "
 				"a policy.\n"
 				"-f\tForce GPT download.\n"
+				"-b SECONDS\tApplier CPU time each calling "
+				"user and each target can spend on forced "
+				"downloads (%g, 0 for no limit).\n"
+				"-r SECONDS\tHow long an exhausted budget "
+				"takes to refill (%g).\n"
+				"-d\tPostpone forced downloads which are over "
+				"budget instead of doing a normal update.\n"
+				"-u COUNT\tRequests each calling user can "
+				"have in progress (%d, 0 for no limit).\n"
+				"-a COUNT\tRequests everyone together can "
+				"have in progress (%d, 0 for no limit).\n"
 				"-p PATH\tOverride the gpo applier "
-				"binary (\"%s\").\n", gpo_exe);
+				"binary (\"%s\").\n", force_budget,
+				force_refill, max_per_caller,
+				max_in_flight, gpo_exe);
 			return 1;
 		}
 	}